@@ -5,6 +5,8 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <cstdlib>
+#include <climits>
 
 
 const size_t TEST_DIST = 400; /// constant for minimal available instance
@@ -13,6 +15,7 @@ int TEST_STEPS = 512; /// constant of maximum number of steps
 uint8_t* red = NULL; /// constant for defining the array for Red segment of RGB colors
 uint8_t* green = NULL; /// constant for defining the array for Green segment of RGB colors
 uint8_t* blue = NULL; /// constant for defining the array for Blue segment of RGB colors
+size_t paletteSize = 0; /// number of bytes reserved for each of the color arrays
 
 #define MIN_X -2.1
 #define MAX_X 0.67
@@ -24,10 +27,15 @@ uint8_t* blue = NULL; /// constant for defining the array for Blue segment of RG
 #define WIDTH 1000
 #define HEIGHT 600
 
+#define CACHE_LINE_SHIFT 6 /// log2 of CACHE_LINE
+#define CACHE_LINE (1 << CACHE_LINE_SHIFT) /// alignment of every buffer handed out by the memory subsystem
+#define POOL_CLASSES (sizeof(size_t) * CHAR_BIT - CACHE_LINE_SHIFT) /// number of power-of-two size classes in the buffer pool, all representable in size_t
+
 SDL_Window* gWindow; /// SDL2 Window
 SDL_Renderer* gRenderer; /// SDL2 Renderer
 SDL_Texture* gScreen; /// SDL2 texture for Screen
 SDL_Texture* gTemp; /// SDL2 Temporary Texture
+SDL_Surface* gExport; /// SDL2 Surface reused for every exported image
 
 /// @brief Class that defines a double part of the Mandelbrot fractal
 class DoubleSelection{
@@ -234,6 +242,189 @@ class Complex{
         double imaginary; /// imaginary part of the complex number
 };
 
+/// @brief Gauge of the memory reserved from the system by the arena and the pool
+struct MemoryGauge{
+    size_t current = 0; /// bytes currently reserved
+    size_t peak = 0; /// maximal number of bytes ever reserved
+    size_t heapAllocations = 0; /// number of calls to the system allocator
+
+    /// @brief registers a new block taken from the system
+    /// @param bytes size of the block
+    void grow(const size_t bytes){
+        current += bytes;
+        heapAllocations++;
+        if(current > peak)
+            peak = current;
+    }
+
+    /// @brief registers a block returned to the system
+    /// @param bytes size of the block
+    void shrink(const size_t bytes){
+        current -= bytes;
+    }
+};
+
+MemoryGauge gMemory; /// gauge shared by the arena and the pool
+
+/// @brief function that rounds a size up to a whole number of cache lines
+/// @param bytes requested size
+/// @return rounded size
+size_t align_up(const size_t bytes) {
+    return (bytes + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+/// @brief function that takes a cache-line aligned block from the system
+/// @param bytes size of the block, multiple of CACHE_LINE
+/// @return pointer to the block
+void* system_alloc(const size_t bytes) {
+    void* block = std::aligned_alloc(CACHE_LINE, bytes);
+    if(!block) {
+        std::cerr << "Unable to allocate " << bytes << " bytes" << std::endl;
+        std::abort();
+    }
+    gMemory.grow(bytes);
+    return block;
+}
+
+/// @brief function that returns a block to the system
+/// @param block pointer to the block
+/// @param bytes size of the block
+void system_free(void* block, const size_t bytes) {
+    if(!block)
+        return;
+    std::free(block);
+    gMemory.shrink(bytes);
+}
+
+/// @brief Bump allocator for transient data that lives for a single render
+class FrameArena{
+    public:
+        FrameArena() = default; /// default constructor
+        FrameArena(const FrameArena&) = delete;
+        FrameArena& operator = (const FrameArena&) = delete;
+        ~FrameArena(){ release(); } /// destructor returning the block to the system
+
+        /// @brief makes sure the arena holds at least the given number of bytes
+        /// @param bytes required capacity
+        void reserve(const size_t bytes){
+            size_t needed = align_up(bytes);
+            if(needed <= capacity)
+                return;
+            release();
+            block = (uint8_t*)system_alloc(needed);
+            capacity = needed;
+        }
+
+        /// @brief forgets every allocation of the previous render
+        void reset(){
+            offset = 0;
+        }
+
+        /// @brief allocates a cache-line aligned piece of the arena
+        /// @param bytes size of the piece
+        /// @return pointer to the piece, aborts when the arena is exhausted
+        void* allocate(const size_t bytes){
+            size_t size = align_up(bytes);
+            if(offset + size > capacity) {
+                std::cerr << "Frame arena exhausted: " << bytes << " bytes requested" << std::endl;
+                std::abort();
+            }
+            void* res = block + offset;
+            offset += size;
+            return res;
+        }
+
+        /// @brief returns the block to the system
+        void release(){
+            system_free(block, capacity);
+            block = NULL;
+            capacity = 0;
+            offset = 0;
+        }
+
+    private:
+        uint8_t* block = NULL; /// reserved block
+        size_t capacity = 0; /// size of the reserved block
+        size_t offset = 0; /// first free byte of the block
+};
+
+/// @brief Pool of cache-line aligned buffers grouped in power-of-two size classes
+class BufferPool{
+    public:
+        BufferPool() = default; /// default constructor
+        BufferPool(const BufferPool&) = delete;
+        BufferPool& operator = (const BufferPool&) = delete;
+        ~BufferPool(){ release(); } /// destructor returning every cached buffer to the system
+
+        /// @brief function that returns the size of the class serving a request
+        /// @param bytes requested size
+        /// @return size of the buffer that will be handed out
+        static size_t class_size(const size_t bytes){
+            return (size_t)CACHE_LINE << class_index(bytes);
+        }
+
+        /// @brief takes a buffer from the pool, reaching for the system only when the class is empty
+        /// @param bytes requested size
+        /// @return pointer to a buffer of class_size(bytes) bytes
+        void* acquire(const size_t bytes){
+            size_t index = class_index(bytes);
+            Node* node = freeList[index];
+            if(node) {
+                freeList[index] = node->next;
+                return node;
+            }
+            return system_alloc((size_t)CACHE_LINE << index);
+        }
+
+        /// @brief gives a buffer back to the pool
+        /// @param buffer pointer previously returned by acquire
+        /// @param bytes size passed to acquire
+        void give_back(void* buffer, const size_t bytes){
+            if(!buffer)
+                return;
+            size_t index = class_index(bytes);
+            Node* node = (Node*)buffer;
+            node->next = freeList[index];
+            freeList[index] = node;
+        }
+
+        /// @brief returns every cached buffer to the system
+        void release(){
+            for(size_t i = 0; i < POOL_CLASSES; i++) {
+                while(freeList[i]) {
+                    Node* next = freeList[i]->next;
+                    system_free(freeList[i], (size_t)CACHE_LINE << i);
+                    freeList[i] = next;
+                }
+            }
+        }
+
+    private:
+        /// @brief link stored inside a free buffer
+        struct Node{
+            Node* next; /// next free buffer of the same class
+        };
+
+        /// @brief function that finds the size class of a request
+        /// @param bytes requested size
+        /// @return index of the size class
+        static size_t class_index(const size_t bytes){
+            size_t index = 0;
+            while(((size_t)CACHE_LINE << index) < bytes) {
+                if(++index == POOL_CLASSES) {
+                    std::cerr << "Buffer pool cannot serve " << bytes << " bytes" << std::endl;
+                    std::abort();
+                }
+            }
+            return index;
+        }
+
+        Node* freeList[POOL_CLASSES] = {}; /// free buffers of every size class
+};
+
+FrameArena gArena; /// arena for the data of a single render
+BufferPool gPool; /// pool for the palette buffers
+
 /// @brief enumeration of possible responses to user input
 enum Response { RESP_QUIT, RESP_UP, RESP_DOWN, RESP_LEFT, RESP_RIGHT, RESP_ZOOM_IN, 
                 RESP_ZOOM_OUT, RESP_RESET, RESP_NONE, RESP_EVOLVE, RESP_DEGENERATE,
@@ -249,12 +440,9 @@ void exportImage(const DoubleSelection& ds, const IntSelection& is, const std::s
     std::string filename = "screenshot_" + std::to_string(currentTime) + ".png";
 
     // Save the surface as a PNG image
-    SDL_Surface* surface = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32,
-        0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
-    SDL_RenderReadPixels(gRenderer, nullptr, SDL_PIXELFORMAT_ARGB8888, surface->pixels, surface->pitch);
-    IMG_SavePNG(surface, filename.c_str());
+    SDL_RenderReadPixels(gRenderer, nullptr, SDL_PIXELFORMAT_ARGB8888, gExport->pixels, gExport->pitch);
+    IMG_SavePNG(gExport, filename.c_str());
     std::cout << "Image saved: " << filename << std::endl;
-    SDL_FreeSurface(surface);
 
     // Save the position and note to a file
     std::string positionFilename = "position_" + std::to_string(currentTime) + ".txt";
@@ -278,12 +466,15 @@ void exportImage(const DoubleSelection& ds, const IntSelection& is, const std::s
 
 /// @brief function that initializes the color arrays
 void init_colors() {
-    free(red);
-    free(green);
-    free(blue);
-    red = (uint8_t*)malloc(TEST_STEPS);
-    green = (uint8_t*)malloc(TEST_STEPS);
-    blue = (uint8_t*)malloc(TEST_STEPS);
+    if(BufferPool::class_size(TEST_STEPS) != paletteSize) {
+        gPool.give_back(red, paletteSize);
+        gPool.give_back(green, paletteSize);
+        gPool.give_back(blue, paletteSize);
+        paletteSize = BufferPool::class_size(TEST_STEPS);
+        red = (uint8_t*)gPool.acquire(paletteSize);
+        green = (uint8_t*)gPool.acquire(paletteSize);
+        blue = (uint8_t*)gPool.acquire(paletteSize);
+    }
     for(size_t i = 0; i < TEST_STEPS; i++) {
         double angle = M_PI * 2 / TEST_STEPS * i + 3.7;
         red[i] = sin(M_PI_2 * (sin(angle) + 1) / 2) * 0xFF;
@@ -292,6 +483,18 @@ void init_colors() {
     }
 }
 
+/// @brief function that creates the render targets and buffers for gRenderer
+void init_buffers() {
+    gScreen = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, 
+        WIDTH, HEIGHT);
+    gTemp = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, 
+        WIDTH, HEIGHT);
+    gExport = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32,
+        0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    gArena.reserve(WIDTH * sizeof(uint32_t));
+    init_colors();
+}
+
 /// @brief SDl initialization function
 void init() {
     SDL_Init(SDL_INIT_VIDEO);
@@ -301,15 +504,18 @@ void init() {
     SDL_SetWindowFullscreen(gWindow, SDL_WINDOW_FULLSCREEN);
 #endif
     gRenderer= SDL_CreateRenderer(gWindow, -1, 0);
-    gScreen = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, 
-        WIDTH, HEIGHT);
-    gTemp = SDL_CreateTexture(gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_TARGET, 
-        WIDTH, HEIGHT);
-    init_colors();
+    init_buffers();
 }
 
 /// @brief SDL quit function
 void quit() {
+    gPool.give_back(red, paletteSize);
+    gPool.give_back(green, paletteSize);
+    gPool.give_back(blue, paletteSize);
+    red = green = blue = NULL;
+    gPool.release();
+    gArena.release();
+    SDL_FreeSurface(gExport);
     SDL_DestroyTexture(gScreen);
     SDL_DestroyTexture(gTemp);
     SDL_DestroyRenderer(gRenderer);
@@ -368,16 +574,22 @@ void draw(const DoubleSelection &ds, const IntSelection &is, const bool pres) {
     double hUnit = (ds.getMaxX() - ds.getMinX()) / (WIDTH / (is.getMaxX() - is.getMinX())) / width;
     double vUnit = (ds.getMaxY() - ds.getMinY()) / (HEIGHT / (is.getMaxY() - is.getMinY())) / height;
     Complex comp;
+    gArena.reserve(width * sizeof(uint32_t));
+    gArena.reset();
+    uint32_t* row = (uint32_t*)gArena.allocate(width * sizeof(uint32_t));
     for(unsigned i = is.getMinY(); i < is.getMaxY(); i++) {
         comp.setImaginary(ds.getMaxY() - i * vUnit);
-        for(unsigned j = is.getMinX(); j < is.getMaxX(); j++) {
-            comp.setReal(ds.getMinX() + j * hUnit);
-            size_t steps = count_steps(comp);
+        for(int k = 0; k < width; k++) {
+            comp.setReal(ds.getMinX() + (is.getMinX() + k) * hUnit);
+            row[k] = count_steps(comp);
+        }
+        for(int k = 0; k < width; k++) {
+            size_t steps = row[k];
             if(steps != TEST_STEPS)
                 SDL_SetRenderDrawColor(gRenderer, red[steps], green[steps], blue[steps], 0xFF);
             else
                 SDL_SetRenderDrawColor(gRenderer, 0, 0, 0, 0);
-            SDL_RenderDrawPoint(gRenderer, j, i);
+            SDL_RenderDrawPoint(gRenderer, is.getMinX() + k, i);
             
         }
         if(pres) 
@@ -647,6 +859,7 @@ void proceed() {
     loop(ds, is, &dhStep, &dvStep, &ihStep, &ivStep);
 }
 
+#ifndef NO_MAIN
 /// @brief function that initializes the application
 /// @param argc argument count
 /// @param argv argument vector
@@ -657,3 +870,4 @@ int main(int argc, char *argv[]) {
     quit();
     return 0;
 }
+#endif
@@ -0,0 +1,126 @@
+#define NO_MAIN
+#include "main.cpp"
+#include <cerrno>
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+}
+
+size_t heapCalls = 0; /// number of calls to the C allocator, including those of operator new and SDL
+
+/// @brief malloc counting every call
+void* malloc(size_t size) noexcept {
+    heapCalls++;
+    return __libc_malloc(size);
+}
+
+/// @brief calloc counting every call
+void* calloc(size_t count, size_t size) noexcept {
+    heapCalls++;
+    return __libc_calloc(count, size);
+}
+
+/// @brief realloc counting every call
+void* realloc(void* ptr, size_t size) noexcept {
+    heapCalls++;
+    return __libc_realloc(ptr, size);
+}
+
+/// @brief aligned_alloc counting every call
+void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    heapCalls++;
+    return __libc_memalign(alignment, size);
+}
+
+/// @brief memalign counting every call
+void* memalign(size_t alignment, size_t size) noexcept {
+    heapCalls++;
+    return __libc_memalign(alignment, size);
+}
+
+/// @brief posix_memalign counting every call
+int posix_memalign(void** ptr, size_t alignment, size_t size) noexcept {
+    heapCalls++;
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr ? 0 : ENOMEM;
+}
+
+/// @brief function that runs one palette step up and back down
+void palette_step() {
+    TEST_STEPS++;
+    init_colors();
+    TEST_STEPS--;
+    init_colors();
+}
+
+/// @brief function that runs every navigation step once
+/// @param ds double selection
+/// @param is int selection
+/// @param dhStep double horizontal step
+/// @param dvStep double vertical step
+/// @param ihStep int horizontal step
+/// @param ivStep int vertical step
+void navigate(DoubleSelection &ds, IntSelection &is, double* dhStep, double* dvStep,
+        int* ihStep, int* ivStep) {
+    move_up(ds, is, *dvStep, *ivStep);
+    move_down(ds, is, *dvStep, *ivStep);
+    move_left(ds, is, *dhStep, *ihStep);
+    move_right(ds, is, *dhStep, *ihStep);
+    zoom_in(ds, is, dhStep, dvStep, ihStep, ivStep);
+    zoom_out(ds, is, dhStep, dvStep, ihStep, ivStep);
+    reset(ds, is, dhStep, dvStep, ihStep, ivStep);
+}
+
+/// @brief test that steady-state navigation does no heap allocations
+/// @return 0 on success, 1 when an allocation was made
+int main() {
+    TEST_STEPS = 64;
+
+    // software renderer drawing into a surface, no window is needed
+    SDL_Surface* target = SDL_CreateRGBSurface(0, WIDTH, HEIGHT, 32,
+        0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    gRenderer = SDL_CreateSoftwareRenderer(target);
+    if(!gRenderer) {
+        std::cerr << "Unable to create renderer: " << SDL_GetError() << std::endl;
+        return 1;
+    }
+    init_buffers();
+
+    DoubleSelection ds;
+    IntSelection is;
+    double dhStep, dvStep;
+    int ihStep, ivStep;
+    reset(ds, is, &dhStep, &dvStep, &ihStep, &ivStep);
+
+    // the first pass may fill caches of SDL and the pool
+    navigate(ds, is, &dhStep, &dvStep, &ihStep, &ivStep);
+    palette_step();
+
+    size_t before = heapCalls;
+    navigate(ds, is, &dhStep, &dvStep, &ihStep, &ivStep);
+    size_t made = heapCalls - before;
+
+    // palette buffers must come back from the pool, not from malloc
+    before = heapCalls;
+    palette_step();
+    size_t palette = heapCalls - before;
+
+    size_t peak = gMemory.peak;
+    quit();
+    SDL_FreeSurface(target);
+
+    if(made) {
+        std::cerr << "FAIL: " << made << " heap allocations during navigation" << std::endl;
+        return 1;
+    }
+    if(palette) {
+        std::cerr << "FAIL: " << palette << " heap allocations for the palette" << std::endl;
+        return 1;
+    }
+    std::cout << "OK: no heap allocations during navigation, memory peak "
+        << peak << " bytes" << std::endl;
+    return 0;
+}